@@ -5,6 +5,7 @@
 
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <algorithm>
 #include <iostream>
 #include <iomanip>
 #include <future>
@@ -59,6 +60,7 @@ void Application::CalculateRayDirections(std::vector<glm::vec3>& rayDirections)
 void Application::SetScene(const Scene* scene)
 {
     m_Scene = scene;
+    m_CompiledScene = CompileScene(*scene);
 }
 
 void Application::Render()
@@ -74,6 +76,9 @@ void Application::Render()
     std::cout << "Everything took " << totalTimer.Elapsed() << "ms!" << std::endl;
 
     m_Image->SaveToFile(m_Settings.OutputPath);
+
+    if (!m_Settings.HeatmapPath.empty())
+        SaveHeatmap();
 }
 
 void Application::BuildSamples()
@@ -87,12 +92,21 @@ void Application::BuildSamples()
         m_Settings.ThreadCount = m_Settings.Samples;
     }
 
+    const bool recordRayCounts = !m_Settings.HeatmapPath.empty();
+
     // Predicted memory usage in MiB
-    // 2 image sized vectors per thread + m_Image
-    const uint32_t memUsage = (2 * m_Settings.ThreadCount + 1) * m_Image->GetSize() * sizeof(glm::vec3) / 1024 / 1024;
+    // 2 image sized vectors per thread + m_Image, plus ray counters when recording a heatmap
+    const uint32_t memUsage = ((2 * m_Settings.ThreadCount + 1) * m_Image->GetSize() * sizeof(glm::vec3)
+        + recordRayCounts * (m_Settings.ThreadCount + 1) * m_Image->GetSize() * sizeof(uint32_t)) / 1024 / 1024;
+
+    struct ThreadResult
+    {
+        std::vector<glm::vec3> colors;
+        std::vector<uint32_t> rayCounts;
+    };
 
     // Array storing every thread task
-    std::vector<std::future<std::vector<glm::vec3>>> threads;
+    std::vector<std::future<ThreadResult>> threads;
     threads.reserve(m_Settings.ThreadCount);
 
     struct ThreadStatus
@@ -111,13 +125,18 @@ void Application::BuildSamples()
         statusPtr->sampleCount = samplesPerThread + (th < m_Settings.Samples % m_Settings.ThreadCount);
 
         // Thread body
-        auto threadFn = [this, statusPtr]()
+        auto threadFn = [this, statusPtr, recordRayCounts]()
         {
             Random::Init();
 
-            std::vector<glm::vec3> arr;
+            ThreadResult result;
+            std::vector<glm::vec3>& arr = result.colors;
             arr.resize(m_Image->GetSize(), glm::vec3(0.0f));
 
+            // Traced rays per pixel, only stored when a heatmap was requested
+            if (recordRayCounts)
+                result.rayCounts.resize(m_Image->GetSize(), 0);
+
             std::vector<glm::vec3> rayDirections;
             rayDirections.resize(m_Image->GetSize());
 
@@ -128,13 +147,17 @@ void Application::BuildSamples()
                 {
                     for (uint32_t x = 0; x < m_Image->GetWidth(); x++)
                     {
-                        arr[y * m_Image->GetWidth() + x] += RayGen(x, y, rayDirections);
+                        const uint32_t index = y * m_Image->GetWidth() + x;
+                        uint32_t rayCount = 0;
+                        arr[index] += RayGen(x, y, rayDirections, rayCount);
+                        if (recordRayCounts)
+                            result.rayCounts[index] += rayCount;
                     }
                 }
                 statusPtr->completedSamples++;
             }
 
-            return arr;
+            return result;
         };
 
         threads.emplace_back(std::async(std::launch::async, threadFn));
@@ -170,15 +193,21 @@ void Application::BuildSamples()
 
     // Merge all thread results into one single image
     std::vector<glm::vec3>& rawImage = m_Image->GetRawArr();
+    if (recordRayCounts)
+        m_RayCounts.assign(m_Image->GetSize(), 0);
+
     for (auto& th : threads)
     {
-        std::vector<glm::vec3> arr = th.get();
+        ThreadResult result = th.get();
         std::vector<glm::vec3>::iterator imagePtr = rawImage.begin();
-        for (const auto& px : arr)
+        for (const auto& px : result.colors)
         {
             *imagePtr += px / glm::vec3(m_Settings.Samples);
             imagePtr++;
         }
+
+        for (size_t i = 0; i < result.rayCounts.size(); i++)
+            m_RayCounts[i] += result.rayCounts[i];
     }
 }
 
@@ -216,30 +245,103 @@ void Application::PostProcess()
     std::cout << postProcessTimer.Elapsed() << "ms" << std::endl;
 }
 
-glm::vec3 Application::RayGen(uint32_t x, uint32_t y, const std::vector<glm::vec3>& rayDirections) const
+void Application::SaveHeatmap() const
 {
-    Ray ray(m_Scene->CameraPos, rayDirections[y * m_Image->GetWidth() + x]);
+    // Rays are traced against every sphere, so ray count is proportional to render time
+    uint32_t minCount = std::numeric_limits<uint32_t>::max();
+    uint32_t maxCount = 0;
+    uint64_t totalCount = 0;
+    for (const auto count : m_RayCounts)
+    {
+        minCount = std::min(minCount, count);
+        maxCount = std::max(maxCount, count);
+        totalCount += count;
+    }
+
+    // Black -> blue -> red -> yellow -> white color ramp
+    auto heatColor = [](float t) -> glm::vec3
+    {
+        const glm::vec3 ramp[] = {
+            glm::vec3(0.0f, 0.0f, 0.0f),
+            glm::vec3(0.0f, 0.0f, 1.0f),
+            glm::vec3(1.0f, 0.0f, 0.0f),
+            glm::vec3(1.0f, 1.0f, 0.0f),
+            glm::vec3(1.0f, 1.0f, 1.0f)
+        };
+        const uint32_t segments = std::size(ramp) - 1;
+
+        t = glm::clamp(t, 0.0f, 1.0f) * segments;
+        const uint32_t i = std::min(static_cast<uint32_t>(t), segments - 1);
+        return glm::mix(ramp[i], ramp[i + 1], t - i);
+    };
+
+    Image heatmap(m_Image->GetWidth(), m_Image->GetHeight());
+    for (uint32_t y = 0; y < heatmap.GetHeight(); y++)
+    {
+        for (uint32_t x = 0; x < heatmap.GetWidth(); x++)
+        {
+            const uint32_t count = m_RayCounts[y * heatmap.GetWidth() + x];
+            heatmap.Set(x, y, heatColor(maxCount > 0 ? static_cast<float>(count) / maxCount : 0.0f));
+        }
+    }
+    heatmap.SaveToFile(m_Settings.HeatmapPath);
+
+    // Histogram of average rays per sample for every pixel
+    const uint32_t BIN_COUNT = 10;
+    const uint32_t BAR_WIDTH = 32;
+    const float samples = static_cast<float>(m_Settings.Samples);
+    const float minAvg = minCount / samples;
+    const float maxAvg = maxCount / samples;
+    const float binSize = std::max(maxAvg - minAvg, 1e-6f) / BIN_COUNT;
+
+    std::vector<uint32_t> bins(BIN_COUNT, 0);
+    for (const auto count : m_RayCounts)
+    {
+        const uint32_t bin = static_cast<uint32_t>((count / samples - minAvg) / binSize);
+        bins[std::min(bin, BIN_COUNT - 1)]++;
+    }
+
+    std::cout << "Rays per sample: min " << minAvg << ", avg " << totalCount / samples / m_RayCounts.size()
+        << ", max " << maxAvg << "\n";
+    for (uint32_t i = 0; i < BIN_COUNT; i++)
+    {
+        const float share = static_cast<float>(bins[i]) / m_RayCounts.size();
+        std::cout << std::fixed << std::setprecision(2)
+            << std::setw(6) << minAvg + i * binSize << " - " << std::setw(6) << minAvg + (i + 1) * binSize << ": ["
+            << std::string(static_cast<size_t>(share * BAR_WIDTH), '#') << std::string(BAR_WIDTH - static_cast<size_t>(share * BAR_WIDTH), ' ')
+            << "] " << std::setw(6) << share * 100.0f << "%\n";
+    }
+    std::cout << std::defaultfloat << std::setprecision(6) << std::flush;
+}
+
+glm::vec3 Application::RayGen(uint32_t x, uint32_t y, const std::vector<glm::vec3>& rayDirections, uint32_t& rayCount) const
+{
+    // Every path gets its own time in the shutter interval for motion blur
+    Ray ray(m_Scene->CameraPos, rayDirections[y * m_Image->GetWidth() + x], Random::Float());
 
     glm::vec3 light(0.0f);
     glm::vec3 throughput(1.0f);
 
     for (uint32_t i = 0; i <= m_Settings.Bounces; i++)
     {
-        HitPayload payload = ray.Trace(m_Scene);
+        HitPayload payload = ray.Trace(&m_CompiledScene);
+        rayCount++;
         if (payload.HitDistance < 0) {
-            light += m_Scene->GetSkyLight() * throughput;
+            light += m_CompiledScene.SkyLight * throughput;
             break;
         }
 
-        const Sphere& sphere = m_Scene->Spheres[payload.ObjIndex];
-        const Material& material = m_Scene->Materials[sphere.MatIndex];
+        const PackedMaterial& material = m_CompiledScene.Materials[m_CompiledScene.SphereMaterials[payload.ObjIndex]];
         
-        light += material.GetEmission() * throughput;
+        light += material.Emission * throughput;
         throughput *= material.Albedo;
 
-        ray.SetOrigin(payload.HitPosition + payload.WorldNormal * 0.0001f);
-        glm::vec3 diffuse = glm::normalize(payload.WorldNormal + Random::UnitSphere());
-        glm::vec3 specular = glm::reflect(ray.GetDirection(), payload.WorldNormal);
+        const glm::vec3 hitPosition = ray.GetHitPosition(payload);
+        const glm::vec3 worldNormal = ray.GetHitNormal(&m_CompiledScene, payload);
+
+        ray.SetOrigin(hitPosition + worldNormal * 0.0001f);
+        glm::vec3 diffuse = glm::normalize(worldNormal + Random::UnitSphere());
+        glm::vec3 specular = glm::reflect(ray.GetDirection(), worldNormal);
         ray.SetDirection(glm::mix(specular, diffuse, material.Roughness));
     }
 
@@ -11,6 +11,8 @@ struct AppSettings
     uint32_t Height = 256;
     std::string OutputPath = "render.png";
     std::string ScenePath = "";
+    // Optional per-pixel ray count heatmap, disabled when empty
+    std::string HeatmapPath = "";
 
     uint32_t Samples = 16;
     uint32_t Bounces = 5;
@@ -28,6 +30,8 @@ private:
     std::unique_ptr<Image> m_Image;
     AppSettings m_Settings;
     const Scene* m_Scene;
+    CompiledScene m_CompiledScene;
+    std::vector<uint32_t> m_RayCounts;
 
     glm::mat4 m_Projection;
     glm::mat4 m_InverseProjection;
@@ -39,6 +43,7 @@ private:
 
     void BuildSamples();
     void PostProcess();
+    void SaveHeatmap() const;
 
-    glm::vec3 RayGen(uint32_t, uint32_t, const std::vector<glm::vec3>&) const;
+    glm::vec3 RayGen(uint32_t, uint32_t, const std::vector<glm::vec3>&, uint32_t&) const;
 };
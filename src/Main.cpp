@@ -40,6 +40,7 @@ AppSettings ParseCommandLine(int argc, char* argv[])
 
     CMDLINE_STRING_ARG("--input", "-i", out.ScenePath);
     CMDLINE_STRING_ARG("--out", "-o", out.OutputPath);
+    CMDLINE_STRING_ARG("--heatmap", "-m", out.HeatmapPath);
 
     if (out.ScenePath.empty())
         throw std::runtime_error("Input parameter is required!");
@@ -4,22 +4,23 @@
 
 #include <glm/glm.hpp>
 
+// Minimal hit record, position and normal are computed on demand
 struct HitPayload
 {
     float HitDistance;
-    glm::vec3 HitPosition;
-    glm::vec3 WorldNormal;
     uint32_t ObjIndex;
 };
 
 class Ray
 {
 public:
-    Ray(glm::vec3 origin, glm::vec3 direction)
-        : m_Origin(origin), m_Direction(direction) {}
+    Ray(glm::vec3 origin, glm::vec3 direction, float time = 0.0f)
+        : m_Origin(origin), m_Direction(direction), m_Time(time) {}
 
     glm::vec3 GetOrigin() const { return m_Origin; }
     glm::vec3 GetDirection() const { return m_Direction; }
+    // Point in the shutter interval, 0 at open and 1 at close
+    float GetTime() const { return m_Time; }
 
     void SetOrigin(const glm::vec3& origin) { m_Origin = origin; }
     void SetDirection(const glm::vec3& direction) { m_Direction = direction; }
@@ -44,51 +45,51 @@ public:
         return glm::dot(m_Direction, normal) > 0.0f;
     }
 
-    HitPayload Trace(const Scene* scene) const
+    HitPayload Trace(const CompiledScene* scene) const
     {
         int closestSphere = -1;
         float hitDistance = std::numeric_limits<float>::max();
-        for (size_t i = 0; i < scene->Spheres.size(); i++)
-        {
-            const Sphere& sphere = scene->Spheres[i];
-            glm::vec3 origin = m_Origin - sphere.Position;
-
-            float a = glm::dot(m_Direction, m_Direction);
-            float b = 2.0f * glm::dot(origin, m_Direction);
-            float c = glm::dot(origin, origin) - sphere.Radius * sphere.Radius;
 
-            float disc = b * b - 4.0f * a * c;
-            if (disc < 0.0f)
-                continue;
+        // Direction is the same for every sphere, so it is hoisted out of the loop
+        const float a = glm::dot(m_Direction, m_Direction);
+        for (uint32_t i = 0; i < scene->FirstMovingSphere; i++)
+        {
+            const PackedSphere& sphere = scene->Spheres[i];
+            if (IntersectSphere(sphere.Position, sphere.RadiusSquared, a, hitDistance))
+                closestSphere = static_cast<int>(i);
+        }
 
-            float closestT = (-b - glm::sqrt(disc)) / (2.0f * a);
-            if (closestT > 0.0f && closestT < hitDistance)
-            {
-                hitDistance = closestT;
+        // Moving spheres are evaluated at the ray's time
+        for (uint32_t i = scene->FirstMovingSphere; i < scene->Spheres.size(); i++)
+        {
+            const PackedSphere& sphere = scene->Spheres[i];
+            const glm::vec3 position = sphere.Position + scene->Motions[i - scene->FirstMovingSphere] * m_Time;
+            if (IntersectSphere(position, sphere.RadiusSquared, a, hitDistance))
                 closestSphere = static_cast<int>(i);
-            }
         }
         
         if (closestSphere < 0)
             return Miss();
 
-        return ClosestHit(scene, hitDistance, closestSphere);
-    
+        return ClosestHit(hitDistance, closestSphere);
     }
 
-    HitPayload ClosestHit(const Scene* scene, float hitDistance, int objIndex) const
+    HitPayload ClosestHit(float hitDistance, int objIndex) const
     {
         HitPayload payload;
         payload.HitDistance = hitDistance;
         payload.ObjIndex = objIndex;
+        return payload;
+    }
 
-        const Sphere& sphere = scene->Spheres[objIndex];
-        glm::vec3 origin = m_Origin - sphere.Position;
+    glm::vec3 GetHitPosition(const HitPayload& payload) const
+    {
+        return m_Origin + m_Direction * payload.HitDistance;
+    }
 
-        payload.HitPosition = origin + m_Direction * hitDistance;
-        payload.WorldNormal = glm::normalize(payload.HitPosition);
-        payload.HitPosition += sphere.Position;
-        return payload;
+    glm::vec3 GetHitNormal(const CompiledScene* scene, const HitPayload& payload) const
+    {
+        return glm::normalize(GetHitPosition(payload) - scene->GetSpherePosition(payload.ObjIndex, m_Time));
     }
 
     HitPayload Miss() const
@@ -100,4 +101,27 @@ public:
 private:
     glm::vec3 m_Origin;
     glm::vec3 m_Direction;
+    float m_Time;
+
+    // Updates hitDistance and returns true when the sphere is hit closer than it
+    bool IntersectSphere(const glm::vec3& position, float radiusSquared, float a, float& hitDistance) const
+    {
+        glm::vec3 origin = m_Origin - position;
+
+        // Half-b form of the quadratic
+        float halfB = glm::dot(origin, m_Direction);
+        float c = glm::dot(origin, origin) - radiusSquared;
+
+        float disc = halfB * halfB - a * c;
+        if (disc < 0.0f)
+            return false;
+
+        float closestT = (-halfB - glm::sqrt(disc)) / a;
+        if (closestT > 0.0f && closestT < hitDistance)
+        {
+            hitDistance = closestT;
+            return true;
+        }
+        return false;
+    }
 };
\ No newline at end of file
@@ -47,7 +47,26 @@ struct adl_serializer<glm::vec3>
 };
 NLOHMANN_JSON_NAMESPACE_END
 
-NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(Sphere, Position, Radius, MatIndex);
+// PositionEnd defaults to Position, so it can not use the default macro
+void to_json(json& j, const Sphere& sphere)
+{
+    j = {
+        { "Position", sphere.Position },
+        { "PositionEnd", sphere.PositionEnd },
+        { "Radius", sphere.Radius },
+        { "MatIndex", sphere.MatIndex }
+    };
+}
+
+void from_json(const json& j, Sphere& sphere)
+{
+    const Sphere defaultSphere;
+    sphere.Position = j.value("Position", defaultSphere.Position);
+    sphere.PositionEnd = j.value("PositionEnd", sphere.Position);
+    sphere.Radius = j.value("Radius", defaultSphere.Radius);
+    sphere.MatIndex = j.value("MatIndex", defaultSphere.MatIndex);
+}
+
 NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(Material, Albedo, Roughness, EmissionColor, EmissionPower);
 NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(Scene, CameraPos, CameraLookAt, CameraVFOV, SkyColor, SkyIntensity, Spheres, Materials, EnableToneMapping);
 
@@ -58,5 +77,49 @@ Scene SceneFromFile(const std::string& path)
         throw std::runtime_error("Failed to open file: " + path + "!");
 
     json j = json::parse(file);
-    return j.template get<Scene>();
+    Scene scene = j.template get<Scene>();
+
+    for (size_t i = 0; i < scene.Spheres.size(); i++)
+    {
+        const int matIndex = scene.Spheres[i].MatIndex;
+        if (matIndex < 0 || static_cast<size_t>(matIndex) >= scene.Materials.size())
+            throw std::runtime_error("Sphere " + std::to_string(i) + " has invalid MatIndex " + std::to_string(matIndex) + "!");
+    }
+
+    return scene;
+}
+
+CompiledScene CompileScene(const Scene& scene)
+{
+    CompiledScene out;
+    out.SkyLight = scene.GetSkyLight();
+
+    out.Spheres.reserve(scene.Spheres.size());
+    out.SphereMaterials.reserve(scene.Spheres.size());
+
+    auto addSphere = [&out](const Sphere& sphere)
+    {
+        out.Spheres.push_back({ sphere.Position, sphere.Radius * sphere.Radius });
+        out.SphereMaterials.push_back(static_cast<uint32_t>(sphere.MatIndex));
+    };
+
+    for (const auto& sphere : scene.Spheres)
+        if (!sphere.IsMoving())
+            addSphere(sphere);
+
+    out.FirstMovingSphere = static_cast<uint32_t>(out.Spheres.size());
+    for (const auto& sphere : scene.Spheres)
+    {
+        if (sphere.IsMoving())
+        {
+            addSphere(sphere);
+            out.Motions.push_back(sphere.PositionEnd - sphere.Position);
+        }
+    }
+
+    out.Materials.reserve(scene.Materials.size());
+    for (const auto& material : scene.Materials)
+        out.Materials.push_back({ material.Albedo, material.Roughness, material.GetEmission() });
+
+    return out;
 }
@@ -18,8 +18,12 @@ struct Material
 struct Sphere
 {
     glm::vec3 Position{0.0f};
+    // Position at shutter close, equal to Position for static spheres
+    glm::vec3 PositionEnd{0.0f};
     float Radius = 0.5f;
     int MatIndex = 0;
+
+    bool IsMoving() const { return Position != PositionEnd; }
 };
 
 struct Scene
@@ -38,4 +42,44 @@ struct Scene
     bool EnableToneMapping = true;
 };
 
+// Sphere layout used while rendering, radius is stored squared since
+// intersection never needs the plain value
+struct alignas(16) PackedSphere
+{
+    glm::vec3 Position;
+    float RadiusSquared;
+};
+
+// Material layout used while rendering, emission is pre-multiplied
+struct PackedMaterial
+{
+    glm::vec3 Albedo;
+    float Roughness;
+    glm::vec3 Emission;
+};
+
+// Render-time representation of the scene
+// Hot intersection data is kept apart from per-hit shading data
+// Static spheres come first, moving spheres start at FirstMovingSphere
+// and store their shutter-open position plus motion over the shutter interval
+struct CompiledScene
+{
+    std::vector<PackedSphere> Spheres;
+    std::vector<uint32_t> SphereMaterials;
+    std::vector<PackedMaterial> Materials;
+
+    uint32_t FirstMovingSphere = 0;
+    std::vector<glm::vec3> Motions;
+
+    glm::vec3 SkyLight;
+
+    glm::vec3 GetSpherePosition(uint32_t index, float time) const
+    {
+        if (index < FirstMovingSphere)
+            return Spheres[index].Position;
+        return Spheres[index].Position + Motions[index - FirstMovingSphere] * time;
+    }
+};
+
 Scene SceneFromFile(const std::string& path);
+CompiledScene CompileScene(const Scene& scene);